@@ -66,6 +66,7 @@ GPI_TRACE_CONFIG(main, GPI_TRACE_BASE_SELECTION);
 //***** Includes ***********************************************************************************
 
 #include "mixer/mixer.h"
+#include "stats_record.h"
 
 #include "gpi/tools.h"
 #include "gpi/platform.h"
@@ -74,9 +75,12 @@ GPI_TRACE_CONFIG(main, GPI_TRACE_BASE_SELECTION);
 #include "gpi/olf.h"
 #include GPI_PLATFORM_PATH(radio.h)
 
-#include <nrf.h>
+#if GPI_ARCH_IS_DEVICE(nRF52840)
+	#include <nrf.h>
+#endif
 
 #include <stdio.h>
+#include <stddef.h>
 #include <inttypes.h>
 #include <stdlib.h>
 #include <string.h>
@@ -86,6 +90,80 @@ GPI_TRACE_CONFIG(main, GPI_TRACE_BASE_SELECTION);
 
 #define PRINT_HEADER()		printf("# ID:%u ", TOS_NODE_ID)
 
+// Discovery: transmit each beacon on all BLE advertising channels (37/38/39) and rotate the
+// listening channel, instead of using channel 39 only
+#ifndef DISCOVERY_CHANNEL_HOPPING
+	#define DISCOVERY_CHANNEL_HOPPING	1
+#endif
+
+// Discovery ends early if the set of discovered nodes did not change and all received beacons
+// agreed with it (same set digest) for this long
+#define DISCOVERY_STABLE_MS			(5 * MX_DISCOVERY_BEACON_INTERVAL_MS)
+
+// Number of known device IDs gossiped per beacon (the known set is sent round-robin)
+#define DISCOVERY_IDS_PER_BEACON	8
+
+// Max. size of the message each node sends per round. It is fragmented into MSGS_PER_NODE
+// generation rows (plus one length byte). Every node transmits all of its rows, whatever the
+// actual size of its message, so keep this as small as the application allows.
+#ifndef MESSAGE_MAX_SIZE
+	#define MESSAGE_MAX_SIZE		31
+#endif
+
+// Number of generation rows each node contributes
+#define MSGS_PER_NODE				((MESSAGE_MAX_SIZE + MX_PAYLOAD_SIZE) / MX_PAYLOAD_SIZE)
+#if (MSGS_PER_NODE > UINT8_MAX / 2)
+	#error MESSAGE_MAX_SIZE needs too many rows per node for two nodes in the generation, increase MX_PAYLOAD_SIZE
+#elif (MESSAGE_MAX_SIZE > UINT8_MAX)
+	#error MESSAGE_MAX_SIZE exceeds the length field
+#elif (MESSAGE_MAX_SIZE < 6)
+	#error MESSAGE_MAX_SIZE is too small for the test message
+#endif
+
+// max. number of nodes: limited by the tables (MX_MAX_NODES) and the generation size
+// (mx_generation_size = number of nodes * MSGS_PER_NODE is an uint8_t)
+#define DISCOVERY_MAX_NODES			MIN(MX_MAX_NODES, UINT8_MAX / MSGS_PER_NODE)
+
+// Membership cache: store the membership table in flash after discovery and reuse it after
+// reboot (skipping discovery). The last flash page is reserved for it in the memory map file.
+#ifndef MEMBERSHIP_CACHE
+	#define MEMBERSHIP_CACHE		GPI_ARCH_IS_DEVICE(nRF52840)
+#endif
+#define MEMBERSHIP_CACHE_ADDR		0x000FF000
+#define MEMBERSHIP_CACHE_MAGIC		0x4D584D43		// "MXMC"
+#define MEMBERSHIP_CACHE_VERSION	1
+
+// Number of consecutive rounds without any message from another node, or from one particular
+// node, after which the cached membership is considered stale (see membership_check_round())
+#define MEMBERSHIP_CACHE_MAX_FAILED_ROUNDS	10
+
+// Network-wide invalidation: a node that considers the membership stale announces this in its
+// round message, all nodes that receive the announcement forward it and erase their cache at
+// the end of the same round, MEMBERSHIP_RESYNC_ROUNDS rounds after the first announcement
+#define MEMBERSHIP_RESYNC_ROUNDS	3
+
+// Join window: at boot (with valid cache) and between rounds every MEMBERSHIP_JOIN_PERIOD
+// rounds, nodes beacon their membership table and listen for MEMBERSHIP_JOIN_WINDOW_MS, so that
+// nodes in discovery can learn it and unknown (new) nodes are noticed. The period is chosen
+// such that a window falls into every discovery phase (MX_DISCOVERY_DURATION_MS).
+#define MEMBERSHIP_JOIN_WINDOW_MS	(2 * MX_DISCOVERY_BEACON_INTERVAL_MS)
+#define MEMBERSHIP_JOIN_PERIOD		MAX(1, MX_DISCOVERY_DURATION_MS / (2 * (ROUND_GAP_MS + \
+										MEMBERSHIP_JOIN_WINDOW_MS + MX_ROUND_LENGTH * \
+										GPI_TICK_HYBRID_TO_US2(MX_SLOT_LENGTH) / 1000)))
+
+// 1: emit round results as compact binary records (see stats_record.h and tools/stats_decode.c)
+// instead of the printf-formatted report, which allows much shorter gaps between rounds
+#ifndef STATS_BINARY_EXPORT
+	#define STATS_BINARY_EXPORT		0
+#endif
+
+// gap between end of round and start of next round (must cover the UART output of the report)
+#if STATS_BINARY_EXPORT
+	#define ROUND_GAP_MS			50
+#else
+	#define ROUND_GAP_MS			1000
+#endif
+
 //**************************************************************************************************
 //***** Local Typedefs and Class Declarations ******************************************************
 
@@ -97,6 +175,19 @@ typedef struct {
     uint8_t  active;        // 1 if node is active
 } node_info_t;
 
+// Discovery beacon as transmitted on air (BLE PDU layout: S0, LENGTH, payload)
+// In addition to the beacon itself, each frame gossips a part of the sender's known node set
+// and a 32 bit digest of the complete set, such that nodes which are in discovery at the same
+// time converge to the union of their sets.
+typedef struct __attribute__((packed)) {
+    uint8_t             header;         // S0 (PDU header), unused
+    uint8_t             length;         // payload length
+    discovery_beacon_t  beacon;
+    uint32_t            set_digest;     // digest of the sender's known set (incl. sender)
+    uint8_t             num_ids;        // number of valid entries in ids[]
+    uint64_t            ids[DISCOVERY_IDS_PER_BEACON];
+} discovery_frame_t;
+
 // Discovery state
 typedef struct {
     uint64_t    my_device_id;           // This node's device ID
@@ -105,16 +196,37 @@ typedef struct {
     uint8_t     my_logical_id;          // My assigned logical ID (0-based)
     uint8_t     is_coordinator;         // 1 if I am the coordinator
     uint8_t     discovery_complete;     // Discovery phase finished
+    uint32_t    last_change_ms;         // Timestamp of last change of the discovered node set
+    uint32_t    last_conflict_ms;       // Timestamp of last beacon with a different node set
+    uint32_t    set_digest;             // Digest of the known node set (incl. this node)
+    uint8_t     gossip_index;           // Next entry of nodes[] to gossip
 } discovery_state_t;
 
+#if MEMBERSHIP_CACHE
+
+// Membership cache as stored in flash
+typedef struct {
+    uint32_t    magic;                  // MEMBERSHIP_CACHE_MAGIC
+    uint16_t    version;                // MEMBERSHIP_CACHE_VERSION
+    uint16_t    num_nodes;              // number of entries in device_ids[]
+    uint64_t    my_device_id;           // cache is valid for this device only
+    uint8_t     my_logical_id;
+    uint8_t     msgs_per_node;          // generation layout
+    uint8_t     coordinator_selection;  // sort order of device_ids[]
+    uint8_t     reserved;
+    uint32_t    crc;                    // CRC-32 over all fields before crc and device_ids[]
+    uint64_t    device_ids[MX_MAX_NODES];   // sorted membership table
+} membership_cache_t;
+
+#endif
+
 //**************************************************************************************************
 //***** Forward Declarations ***********************************************************************
 
 static void run_discovery_phase(void);
 static void assign_node_ids(void);
 static uint64_t get_device_id(void);
-static void send_discovery_beacon(void);
-static void discovery_rx_callback(uint8_t *payload, uint8_t length, int8_t rssi);
+static void process_discovery_beacon(const discovery_frame_t *frame, int8_t rssi);
 
 //**************************************************************************************************
 //***** Local (Static) Variables *******************************************************************
@@ -125,10 +237,16 @@ static uint32_t		msgs_decoded;
 static uint32_t		msgs_not_decoded;
 static uint32_t		msgs_weak;
 static uint32_t		msgs_wrong;
+static uint8_t		msgs_delivered[MX_MAX_NODES * MSGS_PER_NODE];	// 1 if message already handed over
+static uint8_t		membership_resync;		// rounds left until network-wide rediscovery (0: none)
+static uint8_t		membership_resync_rx;	// earliest announcement received in this round
 
 // Discovery state
 static discovery_state_t discovery_state;
 
+// Membership table: device IDs of all nodes, sorted (index = logical ID)
+static uint64_t membership_table[MX_MAX_NODES];
+
 // Dynamic configuration (extern declarations from mixer_config.h)
 uint8_t mx_num_nodes = 2;          // Default minimum
 uint8_t mx_node_id = 0;
@@ -136,14 +254,20 @@ uint8_t mx_generation_size = 2;    // Will be updated based on discovered nodes
 uint8_t mx_initiator_id = 1;       // First node in payload_distribution
 
 // Dynamic payload distribution array
-static uint8_t payload_distribution[MX_MAX_NODES * 4];  // Max messages
+static uint8_t payload_distribution[MX_MAX_NODES * MSGS_PER_NODE];  // Max messages
 static uint8_t nodes[MX_MAX_NODES];                      // Physical node IDs
 
-// Flag for discovery beacon reception
-static volatile uint8_t discovery_rx_flag = 0;
-static uint8_t discovery_rx_buffer[32];
-static uint8_t discovery_rx_length = 0;
-static int8_t discovery_rx_rssi = 0;
+// Discovery radio buffers
+static discovery_frame_t discovery_rx_frame;
+static discovery_frame_t discovery_tx_frame;
+static uint32_t discovery_rand_state;
+
+// Discovery channels: transmit on all, listen on one at a time (rotating)
+#if DISCOVERY_CHANNEL_HOPPING
+    static const uint8_t discovery_channels[] = {37, 38, 39};
+#else
+    static const uint8_t discovery_channels[] = {39};
+#endif
 
 //**************************************************************************************************
 //***** Global Variables ***************************************************************************
@@ -154,95 +278,263 @@ uint16_t __attribute__((section(".data")))	TOS_NODE_ID = 0;
 //**************************************************************************************************
 //***** Discovery Functions ************************************************************************
 
-// Get nRF52840 unique device ID from FICR
+// Get unique device ID
+// On nRF52840 it is read from FICR. On other platforms (e.g. a native host build, where nrf.h
+// intentionally provides nothing) it is taken from the environment variable MX_DEVICE_ID.
 static uint64_t get_device_id(void)
 {
     uint64_t device_id;
     
+#if GPI_ARCH_IS_DEVICE(nRF52840)
     // Read 64-bit unique device ID from Factory Information Configuration Registers
     device_id = ((uint64_t)NRF_FICR->DEVICEID[1] << 32) | NRF_FICR->DEVICEID[0];
+#else
+    const char *s = getenv("MX_DEVICE_ID");
+    
+    device_id = (NULL != s) ? strtoull(s, NULL, 0) : 0;
+#endif
     
     return device_id;
 }
 
 //**************************************************************************************************
 
-// Send discovery beacon
-static void send_discovery_beacon(void)
+// Pseudo random numbers for beacon backoff (xorshift32, seeded with the device ID)
+static uint32_t discovery_rand(void)
 {
-    discovery_beacon_t beacon;
+    uint32_t x = discovery_rand_state;
     
-    beacon.magic[0] = DISCOVERY_MAGIC_0;
-    beacon.magic[1] = DISCOVERY_MAGIC_1;
-    beacon.device_id = discovery_state.my_device_id;
-    beacon.num_seen = discovery_state.num_discovered;
-    beacon.rssi_hint = 0;  // Can be used for RSSI-based selection
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
     
-    // Send beacon using radio
-    // Use a simple transmission without Mixer protocol
-    gpi_radio_set_channel(39);  // BLE channel for discovery
+    return discovery_rand_state = x;
+}
+
+//**************************************************************************************************
+
+static uint32_t discovery_time_ms(void)
+{
+    return gpi_tick_hybrid_to_us(gpi_tick_hybrid()) / 1000;
+}
+
+//**************************************************************************************************
+#if GPI_ARCH_IS_DEVICE(nRF52840)
+
+// Configure radio for discovery beacons (BLE 1M advertising channel format)
+static void discovery_radio_setup(void)
+{
+    gpi_radio_init(BLE_1M);
+    gpi_radio_ble_set_access_address(0x8E89BED6);
     
-    // Transmit the beacon
-    uint8_t *payload = (uint8_t *)&beacon;
+    // Events are polled, keep the Mixer transport ISR out of the way
+    NRF_RADIO->INTENCLR = -1u;
     
-    // Simple blocking transmission for discovery
-    // In production, this would use interrupt-driven transmission
-    NRF_RADIO->PACKETPTR = (uint32_t)payload;
-    NRF_RADIO->EVENTS_END = 0;
-    NRF_RADIO->TASKS_START = 1;
+    NRF_RADIO->PCNF0 = (1 << RADIO_PCNF0_S0LEN_Pos) | (8 << RADIO_PCNF0_LFLEN_Pos);
+    NRF_RADIO->PCNF1 = ((sizeof(discovery_frame_t) - 2) << RADIO_PCNF1_MAXLEN_Pos) |
+                       (3 << RADIO_PCNF1_BALEN_Pos) | RADIO_PCNF1_WHITEEN_Msk;
+    
+    // Disable radio automatically after each packet, sample RSSI during reception
+    NRF_RADIO->SHORTS = RADIO_SHORTS_READY_START_Msk | RADIO_SHORTS_END_DISABLE_Msk |
+                        RADIO_SHORTS_ADDRESS_RSSISTART_Msk;
+}
+
+//**************************************************************************************************
+
+// Stop any ongoing radio operation (takes a few microseconds)
+static void discovery_radio_stop(void)
+{
+    if (NRF_RADIO->STATE != RADIO_STATE_STATE_Disabled)
+    {
+        NRF_RADIO->EVENTS_DISABLED = 0;
+        NRF_RADIO->TASKS_DISABLE = 1;
+        while (!NRF_RADIO->EVENTS_DISABLED);
+    }
+    
+    NRF_RADIO->EVENTS_DISABLED = 0;
+}
+
+//**************************************************************************************************
+
+// Release radio after discovery
+static void discovery_radio_finish(void)
+{
+    discovery_radio_stop();
+    NRF_RADIO->SHORTS = 0;
+}
+
+//**************************************************************************************************
+
+// Start reception or transmission on given channel, completion is signaled by EVENTS_DISABLED
+static void discovery_radio_start(uint8_t channel, uint8_t tx)
+{
+    gpi_radio_set_channel(channel);
     
-    // Wait for transmission to complete
-    while (!NRF_RADIO->EVENTS_END);
     NRF_RADIO->EVENTS_END = 0;
+    NRF_RADIO->EVENTS_DISABLED = 0;
+    
+    if (tx)
+    {
+        NRF_RADIO->PACKETPTR = (uint32_t)&discovery_tx_frame;
+        NRF_RADIO->TASKS_TXEN = 1;
+    }
+    else
+    {
+        NRF_RADIO->PACKETPTR = (uint32_t)&discovery_rx_frame;
+        NRF_RADIO->TASKS_RXEN = 1;
+    }
 }
 
 //**************************************************************************************************
 
-// Process received discovery beacon
-static void process_discovery_beacon(uint8_t *payload, uint8_t length, int8_t rssi)
+// Return 1 if the operation started with discovery_radio_start() has completed
+static uint8_t discovery_radio_done(void)
+{
+    return NRF_RADIO->EVENTS_DISABLED ? 1 : 0;
+}
+
+//**************************************************************************************************
+
+// Return 1 if a valid packet has been received (to be called after discovery_radio_done())
+static uint8_t discovery_radio_rx_valid(int8_t *rssi)
 {
-    discovery_beacon_t *beacon;
+    *rssi = -(int8_t)NRF_RADIO->RSSISAMPLE;
     
-    // Validate beacon
-    if (length < sizeof(discovery_beacon_t))
-        return;
+    return (NRF_RADIO->EVENTS_END && NRF_RADIO->CRCSTATUS) ? 1 : 0;
+}
+
+#else	// no raw radio access: discovery does not find any other node
+
+static void discovery_radio_setup(void) {}
+static void discovery_radio_stop(void) {}
+static void discovery_radio_finish(void) {}
+static void discovery_radio_start(uint8_t channel, uint8_t tx) { (void)channel; (void)tx; }
+static uint8_t discovery_radio_done(void) { return 0; }
+static uint8_t discovery_radio_rx_valid(int8_t *rssi) { *rssi = 0; return 0; }
+
+#endif
+//**************************************************************************************************
+
+// Prepare beacon frame for transmission
+// The beacon is accessed via the frame (not via a pointer to it) because it is a member of
+// a packed struct, i.e. it may be misaligned.
+static void prepare_discovery_beacon(void)
+{
+    uint8_t n = 0;
     
-    beacon = (discovery_beacon_t *)payload;
+    discovery_tx_frame.beacon.magic[0] = DISCOVERY_MAGIC_0;
+    discovery_tx_frame.beacon.magic[1] = DISCOVERY_MAGIC_1;
+    discovery_tx_frame.beacon.device_id = discovery_state.my_device_id;
+    discovery_tx_frame.beacon.num_seen = discovery_state.num_discovered;
+    discovery_tx_frame.beacon.rssi_hint = 0;  // Can be used for RSSI-based selection
     
-    if (beacon->magic[0] != DISCOVERY_MAGIC_0 || beacon->magic[1] != DISCOVERY_MAGIC_1)
-        return;
+    // Gossip the next part of the known set
+    while ((n < DISCOVERY_IDS_PER_BEACON) && (n < discovery_state.num_discovered))
+    {
+        if (discovery_state.gossip_index >= discovery_state.num_discovered)
+            discovery_state.gossip_index = 0;
+        
+        discovery_tx_frame.ids[n++] = discovery_state.nodes[discovery_state.gossip_index++].device_id;
+    }
+    
+    discovery_tx_frame.header = 0;
+    discovery_tx_frame.set_digest = discovery_state.set_digest;
+    discovery_tx_frame.num_ids = n;
+    discovery_tx_frame.length = offsetof(discovery_frame_t, ids) - 2 + n * sizeof(uint64_t);
+}
+
+//**************************************************************************************************
+
+// Order independent 32 bit hash of a device ID, the set digest is the XOR over all members
+static uint32_t discovery_id_hash(uint64_t id)
+{
+    id ^= id >> 33;
+    id *= 0xFF51AFD7ED558CCDull;
+    id ^= id >> 33;
+    
+    return (uint32_t)id;
+}
+
+//**************************************************************************************************
+
+// Add device ID to the known set (if it is not contained yet), return its entry
+// rssi is INT8_MIN for nodes that are only known from the gossip of other nodes.
+static node_info_t* add_discovered_node(uint64_t device_id, int8_t rssi)
+{
+    node_info_t *node;
     
     // Don't add ourselves
-    if (beacon->device_id == discovery_state.my_device_id)
-        return;
+    if (device_id == discovery_state.my_device_id)
+        return NULL;
     
     // Check if already discovered
     for (uint8_t i = 0; i < discovery_state.num_discovered; i++)
     {
-        if (discovery_state.nodes[i].device_id == beacon->device_id)
-        {
-            // Update existing entry
-            discovery_state.nodes[i].rssi = rssi;
-            discovery_state.nodes[i].last_seen_ms = gpi_tick_hybrid_to_us(gpi_tick_hybrid()) / 1000;
-            return;
-        }
+        if (discovery_state.nodes[i].device_id == device_id)
+            return &discovery_state.nodes[i];
     }
     
+    // Leave room for this node in the membership table: assign_node_ids() appends it to the
+    // discovered nodes, so more than MX_MAX_NODES - 1 entries would overflow all_nodes[] there
+    // (DISCOVERY_MAX_NODES additionally limits the generation size)
+    if (discovery_state.num_discovered >= DISCOVERY_MAX_NODES - 1)
+        return NULL;
+    
     // Add new node
-    if (discovery_state.num_discovered < MX_MAX_NODES)
+    node = &discovery_state.nodes[discovery_state.num_discovered++];
+    node->device_id = device_id;
+    node->rssi = rssi;
+    node->last_seen_ms = discovery_time_ms();
+    node->active = 1;
+    
+    discovery_state.set_digest ^= discovery_id_hash(device_id);
+    discovery_state.last_change_ms = node->last_seen_ms;
+    
+    printf("Discovered node: DevID=0x%08X%08X, RSSI=%d dBm, Total=%u%s\n",
+           (uint32_t)(device_id >> 32),
+           (uint32_t)(device_id & 0xFFFFFFFF),
+           rssi,
+           discovery_state.num_discovered,
+           (INT8_MIN == rssi) ? " (indirect)" : "");
+    
+    return node;
+}
+
+//**************************************************************************************************
+
+// Process received discovery beacon
+static void process_discovery_beacon(const discovery_frame_t *frame, int8_t rssi)
+{
+    node_info_t *node;
+    
+    // Validate beacon
+    if (frame->length < offsetof(discovery_frame_t, ids) - 2)
+        return;
+    
+    if (frame->beacon.magic[0] != DISCOVERY_MAGIC_0 || frame->beacon.magic[1] != DISCOVERY_MAGIC_1)
+        return;
+    
+    if ((frame->num_ids > DISCOVERY_IDS_PER_BEACON) ||
+        (frame->length < offsetof(discovery_frame_t, ids) - 2 + frame->num_ids * sizeof(uint64_t)))
+        return;
+    
+    // Sender is a direct neighbor
+    node = add_discovered_node(frame->beacon.device_id, rssi);
+    if (NULL != node)
     {
-        uint8_t idx = discovery_state.num_discovered;
-        discovery_state.nodes[idx].device_id = beacon->device_id;
-        discovery_state.nodes[idx].rssi = rssi;
-        discovery_state.nodes[idx].last_seen_ms = gpi_tick_hybrid_to_us(gpi_tick_hybrid()) / 1000;
-        discovery_state.nodes[idx].active = 1;
-        discovery_state.num_discovered++;
-        
-        printf("Discovered node: DevID=0x%08X%08X, RSSI=%d dBm, Total=%u\n",
-               (uint32_t)(beacon->device_id >> 32),
-               (uint32_t)(beacon->device_id & 0xFFFFFFFF),
-               rssi,
-               discovery_state.num_discovered);
+        node->rssi = rssi;
+        node->last_seen_ms = discovery_time_ms();
+    }
+    
+    // Merge gossiped part of the sender's set
+    for (uint8_t i = 0; i < frame->num_ids; i++)
+        add_discovered_node(frame->ids[i], INT8_MIN);
+    
+    // Check agreement (after merging, i.e. with our updated set)
+    if ((frame->set_digest != discovery_state.set_digest) ||
+        (frame->beacon.num_seen != discovery_state.num_discovered))
+    {
+        discovery_state.last_conflict_ms = discovery_time_ms();
     }
 }
 
@@ -297,6 +589,10 @@ static void assign_node_ids(void)
         qsort(all_nodes, total_nodes, sizeof(node_info_t), compare_device_ids_desc);
     }
     
+    // Keep sorted membership table
+    for (uint8_t i = 0; i < total_nodes; i++)
+        membership_table[i] = all_nodes[i].device_id;
+    
     // Find our position and assign logical ID (0-based for internal use)
     for (uint8_t i = 0; i < total_nodes; i++)
     {
@@ -319,12 +615,19 @@ static void assign_node_ids(void)
     }
     
     // Build payload distribution (each node sends messages equal to its ID)
-    // Simple distribution: each node sends 1-2 messages
+    // Simple distribution: each node sends MSGS_PER_NODE messages
+    // (add_discovered_node() and membership_cache_load() keep total_nodes within bounds)
+    if (total_nodes * MSGS_PER_NODE > UINT8_MAX)
+    {
+        printf("ERROR: %u nodes x %u rows exceed the max. generation size!\n",
+               total_nodes, (unsigned int)MSGS_PER_NODE);
+        assert(0);
+    }
+    
     mx_generation_size = 0;
     for (uint8_t i = 0; i < total_nodes; i++)
     {
-        uint8_t msgs_per_node = 2;  // Each node sends 2 messages
-        for (uint8_t j = 0; j < msgs_per_node; j++)
+        for (uint8_t j = 0; j < MSGS_PER_NODE; j++)
         {
             payload_distribution[mx_generation_size++] = i + 1;
         }
@@ -367,87 +670,468 @@ static void assign_node_ids(void)
 
 //**************************************************************************************************
 
+// Beacon and listen for (at most) max_ms
+// Beacons gossip the known node set (see prepare_discovery_beacon()). The radio listens
+// continuously. Beacons are sent with randomized backoff (uniform in
+// [0.5, 1.5] x MX_DISCOVERY_BEACON_INTERVAL_MS), optionally on all three advertising channels
+// while the listening channel rotates. With early_exit set, the loop ends as soon as at least
+// one other node has been discovered and the set of discovered nodes has been stable and in
+// agreement with all received beacons for DISCOVERY_STABLE_MS.
+static void discovery_loop(uint32_t max_ms, uint8_t early_exit)
+{
+    uint32_t start_ms, current_ms, next_beacon_ms, next_hop_ms;
+    uint8_t  rx_channel = 0, tx_channel = 0, tx_active = 0;
+    int8_t   rssi;
+    
+    start_ms = discovery_time_ms();
+    discovery_state.last_change_ms = start_ms;
+    discovery_state.last_conflict_ms = start_ms;
+    next_beacon_ms = start_ms + discovery_rand() % MX_DISCOVERY_BEACON_INTERVAL_MS;
+    next_hop_ms = start_ms + MX_DISCOVERY_BEACON_INTERVAL_MS;
+    
+    // Setup radio for discovery (simpler mode, no Mixer) and start listening
+    discovery_radio_setup();
+    discovery_radio_start(discovery_channels[rx_channel], 0);
+    
+    while (1)
+    {
+        current_ms = discovery_time_ms();
+        
+        // Check if time is over or the node set has converged
+        if ((current_ms - start_ms) >= max_ms)
+            break;
+        if (early_exit && !tx_active && (discovery_state.num_discovered > 0) &&
+            ((current_ms - discovery_state.last_change_ms) >= DISCOVERY_STABLE_MS) &&
+            ((current_ms - discovery_state.last_conflict_ms) >= DISCOVERY_STABLE_MS))
+            break;
+        
+        // Beacon transmission in progress: continue on next channel or return to reception
+        if (tx_active)
+        {
+            if (!discovery_radio_done())
+                continue;
+            
+            if (++tx_channel < NUM_ELEMENTS(discovery_channels))
+            {
+                discovery_radio_start(discovery_channels[tx_channel], 1);
+            }
+            else
+            {
+                tx_active = 0;
+                discovery_radio_start(discovery_channels[rx_channel], 0);
+            }
+            continue;
+        }
+        
+        // Packet received: process it and restart reception
+        if (discovery_radio_done())
+        {
+            if (discovery_radio_rx_valid(&rssi))
+                process_discovery_beacon(&discovery_rx_frame, rssi);
+            
+            discovery_radio_start(discovery_channels[rx_channel], 0);
+        }
+        
+        // Send beacon when backoff has expired
+        if ((int32_t)(current_ms - next_beacon_ms) >= 0)
+        {
+            discovery_radio_stop();
+            prepare_discovery_beacon();
+            
+            tx_active = 1;
+            tx_channel = 0;
+            discovery_radio_start(discovery_channels[tx_channel], 1);
+            
+            next_beacon_ms = current_ms + MX_DISCOVERY_BEACON_INTERVAL_MS / 2 +
+                             discovery_rand() % MX_DISCOVERY_BEACON_INTERVAL_MS;
+        }
+        
+        // Rotate listening channel
+        else if ((NUM_ELEMENTS(discovery_channels) > 1) && ((int32_t)(current_ms - next_hop_ms) >= 0))
+        {
+            discovery_radio_stop();
+            
+            rx_channel = (rx_channel + 1) % NUM_ELEMENTS(discovery_channels);
+            discovery_radio_start(discovery_channels[rx_channel], 0);
+            
+            next_hop_ms = current_ms + MX_DISCOVERY_BEACON_INTERVAL_MS;
+        }
+    }
+    
+    discovery_radio_finish();
+}
+
+//**************************************************************************************************
+
 // Run discovery phase
+// Besides discovering direct neighbors, beacons gossip the known node set so that all nodes
+// converge to the same membership table before IDs are assigned. This holds for nodes that
+// are in discovery at the same time: a node that starts when its neighbors have already left
+// discovery (boot skew > DISCOVERY_STABLE_MS) is not seen by them, it learns the table from
+// their join windows (see membership_join_window()) if the membership cache is enabled.
+// Discovery ends early as described at discovery_loop(), or after MX_DISCOVERY_DURATION_MS
+// at the latest. A node that hears nobody (e.g. because its neighbors already left discovery)
+// listens for the full MX_DISCOVERY_DURATION_MS.
 static void run_discovery_phase(void)
 {
-    uint32_t discovery_start_ms, current_ms, last_beacon_ms = 0;
+    uint32_t discovery_start_ms;
     
     printf("\n");
     printf("========================================\n");
     printf("   Starting Node Discovery Phase\n");
     printf("========================================\n");
-    printf("Duration:        %u ms\n", MX_DISCOVERY_DURATION_MS);
+    printf("Max. Duration:   %u ms\n", MX_DISCOVERY_DURATION_MS);
     printf("Beacon Interval: %u ms\n", MX_DISCOVERY_BEACON_INTERVAL_MS);
-    printf("My Device ID:    0x%08X%08X\n",
-           (uint32_t)(discovery_state.my_device_id >> 32),
-           (uint32_t)(discovery_state.my_device_id & 0xFFFFFFFF));
+    printf("Channels:        %u\n", (unsigned int)NUM_ELEMENTS(discovery_channels));
     printf("========================================\n");
     printf("\n");
     
     // Initialize discovery state
     memset(&discovery_state, 0, sizeof(discovery_state_t));
     discovery_state.my_device_id = get_device_id();
+    discovery_state.set_digest = discovery_id_hash(discovery_state.my_device_id);
+    discovery_rand_state = (uint32_t)(discovery_state.my_device_id ^ (discovery_state.my_device_id >> 32)) | 1;
     
-    // Get start time
-    discovery_start_ms = gpi_tick_hybrid_to_us(gpi_tick_hybrid()) / 1000;
+    printf("My Device ID:    0x%08X%08X\n",
+           (uint32_t)(discovery_state.my_device_id >> 32),
+           (uint32_t)(discovery_state.my_device_id & 0xFFFFFFFF));
     
-    // Setup radio for discovery (simpler mode, no Mixer)
-    gpi_radio_init(BLE_1M);
-    gpi_radio_set_channel(39);  // BLE advertising channel
+    discovery_start_ms = discovery_time_ms();
+    discovery_loop(MX_DISCOVERY_DURATION_MS, 1);
+    discovery_state.discovery_complete = 1;
     
-    // Discovery loop
-    while (1)
+    printf("Discovery phase complete after %" PRIu32 " ms. Discovered %u other node(s).\n\n",
+           discovery_time_ms() - discovery_start_ms, discovery_state.num_discovered);
+    
+    // Assign IDs based on discovery results
+    assign_node_ids();
+}
+
+//**************************************************************************************************
+//***** Membership Cache ***************************************************************************
+#if MEMBERSHIP_CACHE
+
+static uint32_t crc32_update(uint32_t crc, const void *data, unsigned int size)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    
+    while (size--)
     {
-        current_ms = gpi_tick_hybrid_to_us(gpi_tick_hybrid()) / 1000;
-        
-        // Check if discovery phase is complete
-        if ((current_ms - discovery_start_ms) >= MX_DISCOVERY_DURATION_MS)
-            break;
-        
-        // Send beacon periodically
-        if ((current_ms - last_beacon_ms) >= MX_DISCOVERY_BEACON_INTERVAL_MS)
+        crc ^= *p++;
+        for (uint8_t k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    
+    return crc;
+}
+
+//**************************************************************************************************
+
+static uint32_t membership_cache_crc(const membership_cache_t *cache)
+{
+    uint32_t crc = -1u;
+    
+    // header up to crc, then the used part of device_ids[]
+    crc = crc32_update(crc, cache, offsetof(membership_cache_t, crc));
+    crc = crc32_update(crc, cache->device_ids, cache->num_nodes * sizeof(uint64_t));
+    
+    return ~crc;
+}
+
+//**************************************************************************************************
+
+// Load membership table from flash into discovery_state, return 1 if the cache is valid
+static uint8_t membership_cache_load(void)
+{
+    const membership_cache_t *cache = (const membership_cache_t *)MEMBERSHIP_CACHE_ADDR;
+    uint64_t my_device_id = get_device_id();
+    uint8_t i, n = 0, pos = UINT8_MAX;
+    
+    if ((cache->magic != MEMBERSHIP_CACHE_MAGIC) ||
+        (cache->version != MEMBERSHIP_CACHE_VERSION) ||
+        (cache->my_device_id != my_device_id) ||
+        (cache->msgs_per_node != MSGS_PER_NODE) ||
+        (cache->coordinator_selection != MX_COORDINATOR_SELECTION) ||
+        (cache->num_nodes < 1) || (cache->num_nodes > DISCOVERY_MAX_NODES) ||
+        (cache->crc != membership_cache_crc(cache)))
+    {
+        return 0;
+    }
+    
+    // The table must be sorted as in assign_node_ids() and our position in it must be the
+    // stored logical ID, otherwise the assignment would differ from the cached one
+    for (i = 0; i < cache->num_nodes; i++)
+    {
+        if ((i > 0) && ((MX_COORDINATOR_SELECTION == 0) ?
+            (cache->device_ids[i - 1] >= cache->device_ids[i]) :
+            (cache->device_ids[i - 1] <= cache->device_ids[i])))
         {
-            send_discovery_beacon();
-            last_beacon_ms = current_ms;
+            return 0;
         }
         
-        // Listen for beacons (simplified polling for this example)
-        // In production, use interrupt-driven reception
-        // Check if there's a pending received packet
-        if (discovery_rx_flag)
-        {
-            discovery_rx_flag = 0;
-            process_discovery_beacon(discovery_rx_buffer, discovery_rx_length, discovery_rx_rssi);
-        }
+        if (cache->device_ids[i] == my_device_id)
+            pos = i;
+    }
+    
+    if (pos != cache->my_logical_id)
+        return 0;
+    
+    memset(&discovery_state, 0, sizeof(discovery_state_t));
+    discovery_state.my_device_id = my_device_id;
+    
+    for (i = 0; i < cache->num_nodes; i++)
+    {
+        if (cache->device_ids[i] == my_device_id)
+            continue;
         
-        // Small delay to prevent busy-waiting
-        gpi_milli_sleep(10);
+        discovery_state.nodes[n].device_id = cache->device_ids[i];
+        discovery_state.nodes[n].rssi = INT8_MIN;
+        discovery_state.nodes[n].active = 1;
+        n++;
     }
     
+    discovery_state.num_discovered = n;
     discovery_state.discovery_complete = 1;
     
-    printf("Discovery phase complete. Discovered %u other node(s).\n\n", 
-           discovery_state.num_discovered);
+    return 1;
+}
+
+//**************************************************************************************************
+
+static void nvmc_wait_ready(void)
+{
+    while (!(NRF_NVMC->READY & NVMC_READY_READY_Msk));
+}
+
+//**************************************************************************************************
+
+// Erase membership cache page
+static void membership_cache_erase(void)
+{
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Een << NVMC_CONFIG_WEN_Pos;
+    nvmc_wait_ready();
     
-    // Assign IDs based on discovery results
-    assign_node_ids();
+    NRF_NVMC->ERASEPAGE = MEMBERSHIP_CACHE_ADDR;
+    nvmc_wait_ready();
+    
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+    nvmc_wait_ready();
+}
+
+//**************************************************************************************************
+
+// Store membership table (to be called after assign_node_ids())
+static void membership_cache_store(void)
+{
+    static membership_cache_t cache;
+    const uint32_t *src = (const uint32_t *)&cache;
+    volatile uint32_t *dst = (volatile uint32_t *)MEMBERSHIP_CACHE_ADDR;
+    unsigned int i;
+    
+    memset(&cache, 0xFF, sizeof(cache));
+    cache.magic = MEMBERSHIP_CACHE_MAGIC;
+    cache.version = MEMBERSHIP_CACHE_VERSION;
+    cache.num_nodes = mx_num_nodes;
+    cache.my_device_id = discovery_state.my_device_id;
+    cache.my_logical_id = discovery_state.my_logical_id;
+    cache.msgs_per_node = MSGS_PER_NODE;
+    cache.coordinator_selection = MX_COORDINATOR_SELECTION;
+    cache.reserved = 0;
+    memcpy(cache.device_ids, membership_table, cache.num_nodes * sizeof(uint64_t));
+    
+    cache.crc = membership_cache_crc(&cache);
+    
+    membership_cache_erase();
+    
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Wen << NVMC_CONFIG_WEN_Pos;
+    nvmc_wait_ready();
+    
+    for (i = 0; i < (offsetof(membership_cache_t, device_ids) + cache.num_nodes * sizeof(uint64_t)) / 4; i++)
+    {
+        dst[i] = src[i];
+        nvmc_wait_ready();
+    }
+    
+    NRF_NVMC->CONFIG = NVMC_CONFIG_WEN_Ren << NVMC_CONFIG_WEN_Pos;
+    nvmc_wait_ready();
+    
+    printf("Membership table stored in flash (%u nodes)\n", cache.num_nodes);
+}
+
+//**************************************************************************************************
+
+// Drop the cache and restart with discovery
+static void membership_cache_invalidate(void)
+{
+    printf("Membership table is stale, rerunning discovery ...\n");
+    membership_cache_erase();
+    NVIC_SystemReset();
+}
+
+//**************************************************************************************************
+
+// Join window: beacon the membership table (gossip, see prepare_discovery_beacon()) and listen
+// for MEMBERSHIP_JOIN_WINDOW_MS. Nodes in discovery learn the table from it. Returns 1 if a
+// node that is not in the table has been heard, i.e. the table is stale.
+static uint8_t membership_join_window(void)
+{
+    uint8_t num_known = discovery_state.num_discovered;
+    uint8_t i;
+    
+    // digest of the table (not restored by membership_cache_load())
+    discovery_state.set_digest = discovery_id_hash(discovery_state.my_device_id);
+    for (i = 0; i < num_known; i++)
+        discovery_state.set_digest ^= discovery_id_hash(discovery_state.nodes[i].device_id);
+    
+    if (!discovery_rand_state)
+        discovery_rand_state = (uint32_t)(discovery_state.my_device_id ^ (discovery_state.my_device_id >> 32)) | 1;
+    
+    discovery_loop(MEMBERSHIP_JOIN_WINDOW_MS, 0);
+    
+    return (discovery_state.num_discovered != num_known) ? 1 : 0;
+}
+
+//**************************************************************************************************
+
+// Announce a network-wide rediscovery (see MEMBERSHIP_RESYNC_ROUNDS)
+static void membership_resync_start(void)
+{
+    if (!membership_resync)
+    {
+        printf("Membership table is stale, announcing rediscovery\n");
+        membership_resync = MEMBERSHIP_RESYNC_ROUNDS;
+    }
+}
+
+//**************************************************************************************************
+
+// Detect stale membership after a round: if we do not receive anything from other nodes for
+// MEMBERSHIP_CACHE_MAX_FAILED_ROUNDS rounds, drop the cache and restart with discovery (the
+// node is isolated, nobody else is affected). If nothing is received from one particular node
+// (e.g. a node that left), all nodes rediscover: resetting alone would just re-learn the same
+// table from the cached neighbors.
+static void membership_check_round(void)
+{
+    static uint8_t  failed_rounds;
+    static uint8_t  owner_failed_rounds[MX_MAX_NODES];
+    unsigned int    owner;
+    
+    // Pending rediscovery: the value sent in a round means "erase at the end of round
+    // + value - 1", take the earliest one we know of (own or received)
+    if (membership_resync_rx && (!membership_resync || (membership_resync_rx < membership_resync)))
+        membership_resync = membership_resync_rx;
+    membership_resync_rx = 0;
+    
+    if (membership_resync)
+    {
+        if (1 == membership_resync)
+            membership_cache_invalidate();
+        
+        membership_resync--;
+        return;
+    }
+    
+    if ((msgs_decoded + msgs_wrong) <= MSGS_PER_NODE)
+    {
+        if (++failed_rounds >= MEMBERSHIP_CACHE_MAX_FAILED_ROUNDS)
+        {
+            printf("No data from other nodes for %u rounds\n", failed_rounds);
+            membership_cache_invalidate();
+        }
+    }
+    else failed_rounds = 0;
+    
+    for (owner = 1; owner <= mx_num_nodes; owner++)
+    {
+        if ((owner == TOS_NODE_ID) || msgs_delivered[(owner - 1) * MSGS_PER_NODE])
+        {
+            owner_failed_rounds[owner - 1] = 0;
+            continue;
+        }
+        
+        if (++owner_failed_rounds[owner - 1] >= MEMBERSHIP_CACHE_MAX_FAILED_ROUNDS)
+        {
+            printf("No data from node %u for %u rounds\n", owner, owner_failed_rounds[owner - 1]);
+            membership_resync_start();
+        }
+    }
+}
+
+#endif
+
+//**************************************************************************************************
+//***** Platform Specific Helpers ******************************************************************
+
+// start hardware random number generator and SysTick timer
+static void platform_hw_init(void)
+{
+#if GPI_ARCH_IS_DEVICE(nRF52840)
+	// Start random number generator (RNG)
+	NRF_RNG->INTENCLR = BV_BY_NAME(RNG_INTENCLR_VALRDY, Clear);
+	NRF_RNG->CONFIG = BV_BY_NAME(RNG_CONFIG_DERCEN, Enabled);
+	NRF_RNG->TASKS_START = 1;
+
+	// enable SysTick timer
+	SysTick->LOAD  = -1u;
+	SysTick->VAL   = 0;
+	SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+#endif
+}
+
+//**************************************************************************************************
+
+// stop random number generator and return the last random byte
+static uint8_t platform_rng_finish(void)
+{
+#if GPI_ARCH_IS_DEVICE(nRF52840)
+	NRF_RNG->TASKS_STOP = 1;
+	return BV_BY_VALUE(RNG_VALUE_VALUE, NRF_RNG->VALUE);
+#else
+	// no hardware RNG: use the device ID and the fast clock as entropy source
+	uint64_t id = get_device_id();
+	return (uint8_t)(id ^ (id >> 8) ^ gpi_tick_fast_native()) | 1;
+#endif
 }
 
 //**************************************************************************************************
 //***** Original Mixer Functions *******************************************************************
 
+#if !STATS_BINARY_EXPORT
+
 // Print results of a Mixer round.
 static void print_results(uint8_t log_id)
 {
-	unsigned int	slot, slot_min, i;
+	// static to keep them off the (small) stack
+	static int16_t	row_slot[UINT8_MAX + 1];			// rank-up slot per row
+	static uint8_t	rank_up_rows[UINT8_MAX + 1];		// filled rows in rank-up order
+	static uint16_t	bucket[MX_ROUND_LENGTH + 2];
+	unsigned int	i, slot;
 	uint32_t		rank = 0;
 
 	// Mixer internal stats (enabled with MX_VERBOSE_STATISTICS)
 	mixer_print_statistics();
 
+	// Collect rank-up slots in one pass and sort the filled rows by slot (counting sort,
+	// stable, i.e. rows with the same slot stay in row order). Slots beyond the round length
+	// should not happen, they share the last bucket if they do.
+	memset(bucket, 0, sizeof(bucket));
 	for (i = 0; i < mx_generation_size; i++)
 	{
-		if (mixer_stat_slot(i) >= 0) ++rank;
+		row_slot[i] = mixer_stat_slot(i);
+		if (row_slot[i] < 0)
+			continue;
+
+		bucket[MIN((unsigned int)row_slot[i], MX_ROUND_LENGTH) + 1]++;
+		++rank;
+	}
+
+	for (slot = 1; slot < NUM_ELEMENTS(bucket); slot++)
+		bucket[slot] += bucket[slot - 1];
+
+	for (i = 0; i < mx_generation_size; i++)
+	{
+		if (row_slot[i] >= 0)
+			rank_up_rows[bucket[MIN((unsigned int)row_slot[i], MX_ROUND_LENGTH)]++] = i;
 	}
 
 	PRINT_HEADER();
@@ -462,57 +1146,312 @@ static void print_results(uint8_t log_id)
 
 	PRINT_HEADER();
 	printf("rank_up_slot=[");
-	for (slot_min = 0; 1; )
+	for (i = 0; i < rank; i++)
+		printf("%u;", (unsigned int)row_slot[rank_up_rows[i]]);
+	printf("]\n");
+
+	PRINT_HEADER();
+	printf("rank_up_row=[");
+	for (i = 0; i < rank; i++)
+		printf("%u;", rank_up_rows[i]);
+	printf("]\n");
+}
+
+#endif
+
+//**************************************************************************************************
+
+// Fragment a message of up to MESSAGE_MAX_SIZE bytes into the rows of node owner. The first
+// byte of the first fragment holds the message length. All rows are written (unused ones
+// zero-padded) because every row is needed to reach full rank.
+static void write_message(unsigned int owner, const void *msg, unsigned int size)
+{
+	// static to keep it off the (small) stack
+	static uint8_t	buffer[MSGS_PER_NODE * MX_PAYLOAD_SIZE];
+	unsigned int	k;
+
+	size = MIN(size, MESSAGE_MAX_SIZE);
+
+	memset(buffer, 0, sizeof(buffer));
+	buffer[0] = size;
+	memcpy(&buffer[1], msg, size);
+
+	for (k = 0; k < MSGS_PER_NODE; k++)
+		mixer_write((owner - 1) * MSGS_PER_NODE + k, &buffer[k * MX_PAYLOAD_SIZE], MX_PAYLOAD_SIZE);
+}
+
+//**************************************************************************************************
+
+// Test message of node owner: owner, round (little endian), rediscovery announcement (see
+// membership_check_round()), pattern. The size differs between nodes to exercise fragmentation.
+static unsigned int test_message_size(unsigned int owner)
+{
+	return 6 + owner % (MESSAGE_MAX_SIZE - 5);
+}
+
+static unsigned int build_test_message(unsigned int owner, uint8_t *msg)
+{
+	unsigned int	size = test_message_size(owner);
+	unsigned int	k;
+
+	msg[0] = owner;
+	msg[1] = round;
+	msg[2] = round >> 8;
+	msg[3] = round >> 16;
+	msg[4] = round >> 24;
+	msg[5] = membership_resync;
+
+	for (k = 6; k < size; k++)
+		msg[k] = owner + k;
+
+	return size;
+}
+
+//**************************************************************************************************
+
+// Handle a message that has been reassembled. Called once per message and round, after the
+// nominal end of round.
+static void message_delivered(unsigned int owner, const uint8_t *msg, unsigned int size)
+{
+	unsigned int	k;
+	int				ok;
+
+	ok = (size == test_message_size(owner)) && (msg[0] == owner);
+	for (k = 6; ok && (k < size); k++)
+		ok = (msg[k] == (uint8_t)(owner + k));
+
+	// rows are counted, so that dec + !dec + weak + wrong = generation size
+	if (ok)
 	{
-		slot = -1u;
-		for (i = 0; i < mx_generation_size; ++i)
-		{
-			if (mixer_stat_slot(i) < slot_min)
-				continue;
+		msgs_decoded += MSGS_PER_NODE;
+	}
+	else
+	{
+		msgs_wrong += MSGS_PER_NODE;
+		return;
+	}
 
-			if (slot > (uint16_t)mixer_stat_slot(i))
-				slot = mixer_stat_slot(i);
-		}
+	// Rediscovery announcement, evaluated in membership_check_round()
+	if (msg[5] && (!membership_resync_rx || (msg[5] < membership_resync_rx)))
+		membership_resync_rx = msg[5];
 
-		if (-1u == slot)
-			break;
+	// Use message of the initiator to check/adapt round number (synchronization)
+	if (owner == mx_initiator_id)
+	{
+		Generic32	r;
 
-		for (i = 0; i < mx_generation_size; ++i)
+		r.u8_ll = msg[1];
+		r.u8_lh = msg[2];
+		r.u8_hl = msg[3];
+		r.u8_hh = msg[4];
+
+		if (1 == round)
 		{
-			if (mixer_stat_slot(i) == slot)
-				printf("%u;", slot);
+			round = r.u32;
+			printf("Synchronized to round %" PRIu32 "\n", r.u32);
+		}
+		else if (r.u32 != round)
+		{
+			printf("Round mismatch: received %" PRIu32 " <> local %" PRIu32 "! Trying resync ...\n", 
+			       r.u32, round);
+			round = 0;	// increments to 1 with next round loop iteration
 		}
-
-		slot_min = slot + 1;
 	}
-	printf("]\n");
+}
 
-	PRINT_HEADER();
-	printf("rank_up_row=[");
-	for (slot_min = 0; 1; )
+//**************************************************************************************************
+
+// Reassemble and deliver the messages decoded in the current round.
+// The rows of node n are (n - 1) * MSGS_PER_NODE ... n * MSGS_PER_NODE - 1 (see
+// assign_node_ids()). mixer_start() returns only after the round is over, so this runs once
+// per round.
+static void deliver_messages(void)
+{
+	// static to keep it off the (small) stack
+	static uint8_t	msg[MSGS_PER_NODE * MX_PAYLOAD_SIZE];
+	unsigned int	owner, k;
+
+	for (owner = 1; owner <= mx_num_nodes; owner++)
 	{
-		slot = -1u;
-		for (i = 0; i < mx_generation_size; ++i)
+		unsigned int	first = (owner - 1) * MSGS_PER_NODE;
+		int				state = 1;		// 1: complete, 0: incomplete, -1: weak
+
+		if (msgs_delivered[first])
+			continue;
+
+		for (k = 0; k < MSGS_PER_NODE; k++)
 		{
-			if (mixer_stat_slot(i) < slot_min)
-				continue;
+			void	*p = mixer_read(first + k);
 
-			if (slot > (uint16_t)mixer_stat_slot(i))
-				slot = mixer_stat_slot(i);
+			if (NULL == p)
+			{
+				state = 0;
+				break;
+			}
+
+			if ((void*)-1 == p)
+				state = -1;
+			else memcpy(&msg[k * MX_PAYLOAD_SIZE], p, MX_PAYLOAD_SIZE);
 		}
 
-		if (-1u == slot)
-			break;
+		if (!state)
+			continue;
 
-		for (i = 0; i < mx_generation_size; ++i)
+		memset(&msgs_delivered[first], 1, MSGS_PER_NODE);
+
+		if (state < 0)
+			msgs_weak += MSGS_PER_NODE;
+		else message_delivered(owner, &msg[1], MIN(msg[0], MESSAGE_MAX_SIZE));
+	}
+}
+
+//**************************************************************************************************
+#if STATS_BINARY_EXPORT
+
+// write bytes to the console UART (escaped, see stats_record.h) and update checksum
+static void stats_write(uint16_t *sum, const void *data, unsigned int size)
+{
+	const uint8_t	*p = (const uint8_t*)data;
+	unsigned int	i;
+
+	stats_record_checksum(sum, data, size);
+
+	for (i = 0; i < size; i++)
+	{
+		if ('\n' == p[i])
+		{
+			putchar(STATS_RECORD_ESC);
+			putchar(STATS_RECORD_ESC_LF);
+		}
+		else if (STATS_RECORD_ESC == p[i])
 		{
-			if (mixer_stat_slot(i) == slot)
-				printf("%u;", i);
+			putchar(STATS_RECORD_ESC);
+			putchar(STATS_RECORD_ESC_ESC);
 		}
+		else putchar(p[i]);
+	}
+}
+
+//**************************************************************************************************
+
+// Emit results of a Mixer round as binary record (replaces print_results()).
+static void emit_stats_record(void)
+{
+	stats_record_header_t	header;
+	stats_record_counters_t	counters;
+	uint16_t				sum = 0;
+	unsigned int			i;
+
+	header.version = STATS_RECORD_VERSION;
+	header.node_id = TOS_NODE_ID;
+	header.flags = 0;
+	header.round = round;
+	header.generation_size = mx_generation_size;
+	header.rank = 0;
+	header.msgs_decoded = msgs_decoded;
+	header.msgs_not_decoded = msgs_not_decoded;
+	header.msgs_weak = msgs_weak;
+	header.msgs_wrong = msgs_wrong;
 
-		slot_min = slot + 1;
+	for (i = 0; i < mx_generation_size; i++)
+	{
+		if (mixer_stat_slot(i) >= 0) ++header.rank;
+	}
+
+	memset(&counters, 0, sizeof(counters));
+	#if MX_VERBOSE_STATISTICS
+	{
+		const Mixer_Stat_Counter	*sc = mixer_statistics();
+
+		header.flags |= STATS_RECORD_FLAG_STATISTICS;
+
+		#define COPY(n)		counters.n = sc->n
+		COPY(num_sent);
+		COPY(num_received);
+		COPY(num_resync);
+		COPY(num_grid_drift_overflow);
+		COPY(num_rx_window_overflow);
+		COPY(num_rx_success);
+		COPY(num_rx_broken);
+		COPY(num_rx_timeout);
+		COPY(num_rx_dma_timeout);
+		COPY(num_rx_dma_late);
+		COPY(num_rx_late);
+		COPY(num_tx_late);
+		COPY(num_tx_zero_packet);
+		COPY(num_tx_fifo_late);
+		COPY(num_grid_late);
+		COPY(num_rx_slot_mismatch);
+		COPY(num_rx_queue_overflow);
+		COPY(num_rx_queue_overflow_full_rank);
+		COPY(num_rx_queue_processed);
+		COPY(slot_full_rank);
+		COPY(slot_decoded);
+		COPY(slot_off);
+		COPY(discovery_exit_slot);
+		COPY(discovery_density);
+		COPY(wake_up_slot);
+		#undef COPY
+
+		counters.radio_on_time = gpi_tick_hybrid_to_us(sc->radio_on_time);
+		counters.low_power_time = gpi_tick_hybrid_to_us(sc->low_power_time);
+	}
+	#endif
+
+	putchar(STATS_RECORD_SYNC_0);
+	putchar(STATS_RECORD_SYNC_1);
+
+	stats_write(&sum, &header, sizeof(header));
+	stats_write(&sum, &counters, sizeof(counters));
+
+	for (i = 0; i < mx_generation_size; i++)
+	{
+		int16_t	slot = mixer_stat_slot(i);
+
+		stats_write(&sum, &slot, sizeof(slot));
+	}
+
+	// append checksum (escaped like the rest of the record, dummy sum is not used)
+	{
+		uint8_t		c[2] = {sum & 0xFF, sum >> 8};
+		uint16_t	dummy = 0;
+
+		stats_write(&dummy, c, sizeof(c));
+	}
+
+	msgs_decoded = 0;
+	msgs_not_decoded = 0;
+	msgs_weak = 0;
+	msgs_wrong = 0;
+}
+
+#endif
+//**************************************************************************************************
+
+// (Re-)init RF transceiver for Mixer operation
+static void mixer_radio_init(void)
+{
+	gpi_radio_init(MX_PHY_MODE);
+	gpi_radio_set_tx_power(gpi_radio_dbm_to_power_level(MX_TX_PWR_DBM));
+	
+	switch (MX_PHY_MODE)
+	{
+		case BLE_1M:
+		case BLE_2M:
+		case BLE_125k:
+		case BLE_500k:
+			gpi_radio_set_channel(39);
+			gpi_radio_ble_set_access_address(~0x8E89BED6);
+			break;
+
+		case IEEE_802_15_4:
+			gpi_radio_set_channel(26);
+			break;
+
+		default:
+			printf("ERROR: MX_PHY_MODE is invalid!\n");
+			assert(0);
 	}
-	printf("]\n");
 }
 
 //**************************************************************************************************
@@ -523,15 +1462,8 @@ static void initialization(void)
 	gpi_platform_init();
 	gpi_int_enable();
 
-	// Start random number generator (RNG)
-	NRF_RNG->INTENCLR = BV_BY_NAME(RNG_INTENCLR_VALRDY, Clear);
-	NRF_RNG->CONFIG = BV_BY_NAME(RNG_CONFIG_DERCEN, Enabled);
-	NRF_RNG->TASKS_START = 1;
-
-	// enable SysTick timer
-	SysTick->LOAD  = -1u;
-	SysTick->VAL   = 0;
-	SysTick->CTRL  = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_ENABLE_Msk;
+	// start RNG and SysTick timer
+	platform_hw_init();
 
 	printf("\n");
 	printf("========================================\n");
@@ -555,37 +1487,34 @@ int main()
 	initialization();
 	
 	// ***** PHASE 1: NODE DISCOVERY AND ID ASSIGNMENT *****
-	run_discovery_phase();
+	#if MEMBERSHIP_CACHE
+		// warm restart: join Mixer using the cached membership table after a short join window
+		// (lets new nodes in; a table without any other node is never cached)
+		if (membership_cache_load() && !membership_join_window())
+		{
+			printf("Using cached membership table, discovery skipped\n");
+			assign_node_ids();
+		}
+		else
+		{
+			run_discovery_phase();
+			
+			if (discovery_state.num_discovered > 0)
+				membership_cache_store();
+			else membership_cache_erase();
+		}
+	#else
+		run_discovery_phase();
+	#endif
 	
 	// Now we have our node ID assigned
 	node_id = discovery_state.my_logical_id;
 	
 	// Re-init RF transceiver for Mixer operation
-	gpi_radio_init(MX_PHY_MODE);
-	gpi_radio_set_tx_power(gpi_radio_dbm_to_power_level(MX_TX_PWR_DBM));
-	
-	switch (MX_PHY_MODE)
-	{
-		case BLE_1M:
-		case BLE_2M:
-		case BLE_125k:
-		case BLE_500k:
-			gpi_radio_set_channel(39);
-			gpi_radio_ble_set_access_address(~0x8E89BED6);
-			break;
-
-		case IEEE_802_15_4:
-			gpi_radio_set_channel(26);
-			break;
-
-		default:
-			printf("ERROR: MX_PHY_MODE is invalid!\n");
-			assert(0);
-	}
+	mixer_radio_init();
 	
 	// Stop RNG and seed random number generator
-	NRF_RNG->TASKS_STOP = 1;
-	uint8_t rng_value = BV_BY_VALUE(RNG_VALUE_VALUE, NRF_RNG->VALUE);
+	uint8_t rng_value = platform_rng_finish();
 	uint32_t rng_seed = rng_value * gpi_mulu_16x16(TOS_NODE_ID, gpi_tick_fast_native());
 	printf("Random seed for Mixer: %" PRIu32"\n", rng_seed);
 	mixer_rand_seed(rng_seed);
@@ -612,9 +1541,11 @@ int main()
 	// Main Mixer loop
 	for (round = 1; 1; round++)
 	{
-		uint8_t	data[7];
+		static uint8_t	msg[MESSAGE_MAX_SIZE];
 
-		printf("Preparing round %" PRIu32 " ...\n", round);
+		#if !STATS_BINARY_EXPORT
+			printf("Preparing round %" PRIu32 " ...\n", round);
+		#endif
 
 		// init mixer with our assigned node_id
 		mixer_init(node_id);
@@ -624,26 +1555,8 @@ int main()
 			mixer_set_weak_return_msg((void*)-1);
 		#endif
 
-		// Provide test data messages based on payload distribution
-		{
-			data[1] = node_id;
-			data[2] = TOS_NODE_ID;
-			data[3] = round;
-			data[4] = round >> 8;
-			data[5] = round >> 16;
-			data[6] = round >> 24;
-
-			for (i = 0; i < mx_generation_size; i++)
-			{
-				data[0] = i;
-
-				// Check if this message belongs to us
-				if (payload_distribution[i] == TOS_NODE_ID)
-				{
-					mixer_write(i, data, MIN(sizeof(data), MX_PAYLOAD_SIZE));
-				}
-			}
-		}
+		// Provide our test message, fragmented into our rows of the payload distribution
+		write_message(TOS_NODE_ID, msg, build_test_message(TOS_NODE_ID, msg));
 
 		// Arm mixer
 		// Coordinator (initiator) or participant
@@ -664,7 +1577,9 @@ int main()
 		}
 
 		// Start when deadline reached
-		printf("Starting round %" PRIu32 " ...\n", round);
+		#if !STATS_BINARY_EXPORT
+			printf("Starting round %" PRIu32 " ...\n", round);
+		#endif
 		while (gpi_tick_compare_hybrid(gpi_tick_hybrid(), t_ref) < 0);
 
 		// Run Mixer round
@@ -674,58 +1589,38 @@ int main()
 		while (gpi_tick_compare_hybrid(gpi_tick_hybrid(), t_ref) < 0);
 
 		// Evaluate received data
+		memset(msgs_delivered, 0, sizeof(msgs_delivered));
+		deliver_messages();
 		for (i = 0; i < mx_generation_size; i++)
 		{
-			void *p = mixer_read(i);
-			if (NULL == p)
-			{
+			if (!msgs_delivered[i])
 				msgs_not_decoded++;
-			}
-			else if ((void*)-1 == p)
-			{
-				msgs_weak++;
-			}
-			else
-			{
-				memcpy(data, p, sizeof(data));
-				if ((data[0] == i) && (data[2] == payload_distribution[i]))
-				{
-					msgs_decoded++;
-				}
-				else
-				{
-					msgs_wrong++;
-				}
-
-				// Use message 0 to check/adapt round number (synchronization)
-				if ((0 == i) && (MX_PAYLOAD_SIZE >= 7))
-				{
-					Generic32	r;
-
-					r.u8_ll = data[3];
-					r.u8_lh = data[4];
-					r.u8_hl = data[5];
-					r.u8_hh = data[6];
-
-					if (1 == round)
-					{
-						round = r.u32;
-						printf("Synchronized to round %" PRIu32 "\n", r.u32);
-					}
-					else if (r.u32 != round)
-					{
-						printf("Round mismatch: received %" PRIu32 " <> local %" PRIu32 "! Trying resync ...\n", 
-						       r.u32, round);
-						round = 0;	// increments to 1 with next round loop iteration
-					}
-				}
-			}
 		}
 
-		print_results(node_id);
+		#if MEMBERSHIP_CACHE
+			membership_check_round();
+		#endif
+
+		#if STATS_BINARY_EXPORT
+			emit_stats_record();
+		#else
+			print_results(node_id);
+		#endif
 
 		// Set start time for next round
-		t_ref += MAX(10 * MX_SLOT_LENGTH, GPI_TICK_MS_TO_HYBRID2(1000));
+		t_ref += MAX(10 * MX_SLOT_LENGTH, GPI_TICK_MS_TO_HYBRID2(ROUND_GAP_MS));
+
+		#if MEMBERSHIP_CACHE
+			// Join window (in the same rounds on all nodes, the next round starts later accordingly)
+			if (!(round % MEMBERSHIP_JOIN_PERIOD))
+			{
+				if (membership_join_window())
+					membership_resync_start();
+
+				mixer_radio_init();
+				t_ref += GPI_TICK_MS_TO_HYBRID2(MEMBERSHIP_JOIN_WINDOW_MS);
+			}
+		#endif
 	}
 
 	GPI_TRACE_RETURN(0);
@@ -37,9 +37,64 @@ static const uint8_t payload_distribution[] = {
 #define MX_PHY_MODE             1
 #define MX_TX_PWR_DBM           8
 
+// Slot length = on-air time of a Mixer packet at MX_PHY_MODE + radio ramp-up + processing time,
+// instead of a worst-case constant.
+// MX_PACKET_SIZE mirrors the PHY payload of struct Packet in the Mixer core (mixer_internal.h,
+// PHY_PAYLOAD_SIZE there): slot number (2), sender ID (1), flags (1), coding vector (G/8
+// rounded up), payload, info vector (G/8 rounded up, only with MX_REQUEST or
+// MX_SMART_SHUTDOWN_MAP). It is needed here because the application uses MX_SLOT_LENGTH
+// but cannot see Packet; keep it in sync with the core when the packet layout changes.
+// MX_SLOT_PROCESSING_US must cover the max. execution time of the RX processing. The 600 us
+// are an unmeasured estimate (about the margin of the former fixed 2000 us slot). With the
+// default configuration (IEEE 802.15.4, 50 nodes, 16 byte payload: 34 byte packet, 1344 us
+// on air) the slot is 2084 us, i.e. slightly longer than the former 2000 us; measure the
+// processing time before lowering the margin.
+#define MX_CODING_VECTOR_SIZE   ((MX_GENERATION_SIZE + 7) / 8)
+#define MX_INFO_VECTOR_SIZE     ((MX_REQUEST || MX_SMART_SHUTDOWN_MAP) ? MX_CODING_VECTOR_SIZE : 0)
+#define MX_PACKET_SIZE          (4 + MX_CODING_VECTOR_SIZE + MX_PAYLOAD_SIZE + MX_INFO_VECTOR_SIZE)
+#define MX_SLOT_RAMP_UP_US      140
+#define MX_SLOT_PROCESSING_US   600
+
+// on-air time in us (incl. preamble, sync/access address, length field and CRC); MX_PHY_MODE
+// values as in Gpi_Radio_Mode (gpi/radio.h): 1 = IEEE 802.15.4, 2 = BLE 1M, 3 = BLE 2M,
+// 4 = BLE 125k, 5 = BLE 500k. Numbers are used so that the macro does not depend on radio.h.
+#define MX_AIRTIME_US(bytes)                                                            \
+    ((MX_PHY_MODE == 1) ? (6 + (bytes) + 2) * 32 :                                      \
+     (MX_PHY_MODE == 2) ? (1 + 4 + 2 + (bytes) + 3) * 8 :                               \
+     (MX_PHY_MODE == 3) ? (2 + 4 + 2 + (bytes) + 3) * 4 :                               \
+     (MX_PHY_MODE == 5) ? 376 + ((2 + (bytes) + 3) * 8 + 3) * 2 :                       \
+                          376 + ((2 + (bytes) + 3) * 8 + 3) * 8)
+
+#define MX_SLOT_LENGTH          GPI_TICK_US_TO_HYBRID2(MX_AIRTIME_US(MX_PACKET_SIZE) + \
+                                    MX_SLOT_RAMP_UP_US + MX_SLOT_PROCESSING_US)
+
 // Use Smart Shutdown Mode 3 (All nodes full rank) for large-scale stability
+// (needs the full-rank map, which is carried in the info vector)
 #define MX_SMART_SHUTDOWN       1
 #define MX_SMART_SHUTDOWN_MODE  3
+#define MX_SMART_SHUTDOWN_MAP   1
+
+// Coordinated TX: every node keeps a history of its neighbors' state (full rank, owned rows)
+// taken from received packets and uses it to decide between TX and RX in each slot, e.g. it
+// stays quiet if a neighbor with more information is about to transmit. Neighbors that have
+// not been heard for MX_HISTORY_WINDOW slots (MX_HISTORY_WINDOW_FINISHED once they reported
+// full rank) are dropped from the history. Values are the Mixer defaults, listed here to be
+// tuned per topology.
+#define MX_COORDINATED_TX           1
+#define MX_HISTORY_WINDOW           (MX_ROUND_LENGTH * 3 / 4)
+#define MX_HISTORY_WINDOW_FINISHED  (1 * MX_NUM_NODES)
+
+// Requests: towards the end of the round, nodes that miss rows announce them in their packets
+// (row and column request masks) and neighbors answer with packets that contain requested
+// rows. This decides whether the last missing messages arrive in time, so keep it enabled.
+// MX_REQUEST_HEURISTIC selects how a node builds the answer from the request masks.
+#define MX_REQUEST                  1
+#define MX_REQUEST_HEURISTIC        2
+
+// Systematic startup: in the first slots after a node acquires a message it transmits the
+// plain message (unit coding vector), so receivers can store it without elimination.
+// Most rank increases happen early in the round, so keep it enabled (0 = enabled).
+#define MX_BENCHMARK_NO_SYSTEMATIC_STARTUP  0
 
 // Keep statistics on for D-Cube logs
 #define MX_VERBOSE_STATISTICS   1
@@ -0,0 +1,156 @@
+/***************************************************************************************************
+ ***************************************************************************************************
+ *
+ *	Copyright (c) 2019, Networked Embedded Systems Lab, TU Dresden
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the NES Lab or TU Dresden nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***********************************************************************************************//**
+ *
+ *	@file					stats_record.h
+ *
+ *	@brief					binary round record format
+ *
+ *	@version				$Id$
+ *	@date					Added for binary statistics export
+ *
+ *	@author					Modified for auto assignment
+ *
+ ***************************************************************************************************
+
+ 	@details
+
+	Compact replacement for the printf-formatted round report of main.c. Shared between the
+	firmware (main.c) and the host side decoder (tools/stats_decode.c).
+
+	A record on the wire consists of:
+		- STATS_RECORD_SYNC_0, STATS_RECORD_SYNC_1
+		- stats_record_header_t
+		- stats_record_counters_t (Mixer statistics counters, see mixer_statistics(); all zero
+		  unless STATS_RECORD_FLAG_STATISTICS is set in the header)
+		- generation_size x int16_t rank-up slot per row (-1 = row not filled)
+		- Fletcher-16 checksum (little endian) over header, counters and rank-up slots
+
+	All multi-byte fields are little endian. Bytes outside of records (e.g. remaining text
+	output) are passed through by the decoder.
+
+	Everything behind the sync bytes is escaped such that a record never contains '\n'
+	(the console output path inserts '\r' before every '\n'): '\n' is sent as
+	STATS_RECORD_ESC STATS_RECORD_ESC_LF and STATS_RECORD_ESC as
+	STATS_RECORD_ESC STATS_RECORD_ESC_ESC. The checksum is computed over the unescaped bytes.
+
+ **************************************************************************************************/
+
+#ifndef __STATS_RECORD_H__
+#define __STATS_RECORD_H__
+
+//**************************************************************************************************
+//***** Includes ***********************************************************************************
+
+#include <stdint.h>
+
+//**************************************************************************************************
+//***** Global Defines and Consts ******************************************************************
+
+#define STATS_RECORD_SYNC_0			0xA5
+#define STATS_RECORD_SYNC_1			0x5A
+#define STATS_RECORD_VERSION		3
+
+// stats_record_header_t.flags
+#define STATS_RECORD_FLAG_STATISTICS	0x01		// counters valid (built with MX_VERBOSE_STATISTICS)
+
+#define STATS_RECORD_ESC			0xDB
+#define STATS_RECORD_ESC_LF			0xDC		// escaped '\n'
+#define STATS_RECORD_ESC_ESC		0xDD		// escaped STATS_RECORD_ESC
+
+//**************************************************************************************************
+//***** Global Typedefs and Class Declarations *****************************************************
+
+typedef struct __attribute__((packed)) {
+	uint8_t		version;
+	uint8_t		node_id;			// TOS_NODE_ID
+	uint8_t		flags;				// STATS_RECORD_FLAG_...
+	uint32_t	round;
+	uint16_t	generation_size;	// number of rank-up slot entries following the header
+	uint16_t	rank;
+	uint16_t	msgs_decoded;
+	uint16_t	msgs_not_decoded;
+	uint16_t	msgs_weak;
+	uint16_t	msgs_wrong;
+} stats_record_header_t;
+
+// counters of mixer_statistics(), times in us
+typedef struct __attribute__((packed)) {
+	uint16_t	num_sent;
+	uint16_t	num_received;
+	uint16_t	num_resync;
+	uint16_t	num_grid_drift_overflow;
+	uint16_t	num_rx_window_overflow;
+	uint16_t	num_rx_success;
+	uint16_t	num_rx_broken;
+	uint16_t	num_rx_timeout;
+	uint16_t	num_rx_dma_timeout;
+	uint16_t	num_rx_dma_late;
+	uint16_t	num_rx_late;
+	uint16_t	num_tx_late;
+	uint16_t	num_tx_zero_packet;
+	uint16_t	num_tx_fifo_late;
+	uint16_t	num_grid_late;
+	uint16_t	num_rx_slot_mismatch;
+	uint16_t	num_rx_queue_overflow;
+	uint16_t	num_rx_queue_overflow_full_rank;
+	uint16_t	num_rx_queue_processed;
+	uint16_t	slot_full_rank;
+	uint16_t	slot_decoded;
+	uint16_t	slot_off;
+	uint16_t	discovery_exit_slot;
+	uint16_t	discovery_density;
+	uint16_t	wake_up_slot;
+	uint32_t	radio_on_time;
+	uint32_t	low_power_time;
+} stats_record_counters_t;
+
+//**************************************************************************************************
+//***** Global Functions ***************************************************************************
+
+// Fletcher-16 checksum, can be called incrementally (initialize *sum with 0)
+static inline void stats_record_checksum(uint16_t *sum, const void *data, unsigned int size)
+{
+	const uint8_t	*p = (const uint8_t*)data;
+	uint16_t		s1 = *sum & 0xFF;
+	uint16_t		s2 = *sum >> 8;
+
+	while (size--)
+	{
+		s1 = (s1 + *p++) % 255;
+		s2 = (s2 + s1) % 255;
+	}
+
+	*sum = (s2 << 8) | s1;
+}
+
+//**************************************************************************************************
+//**************************************************************************************************
+
+#endif // __STATS_RECORD_H__
@@ -0,0 +1,363 @@
+/***************************************************************************************************
+ ***************************************************************************************************
+ *
+ *	Copyright (c) 2019, Networked Embedded Systems Lab, TU Dresden
+ *	All rights reserved.
+ *
+ *	Redistribution and use in source and binary forms, with or without
+ *	modification, are permitted provided that the following conditions are met:
+ *		* Redistributions of source code must retain the above copyright
+ *		  notice, this list of conditions and the following disclaimer.
+ *		* Redistributions in binary form must reproduce the above copyright
+ *		  notice, this list of conditions and the following disclaimer in the
+ *		  documentation and/or other materials provided with the distribution.
+ *		* Neither the name of the NES Lab or TU Dresden nor the
+ *		  names of its contributors may be used to endorse or promote products
+ *		  derived from this software without specific prior written permission.
+ *
+ *	THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ *	ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ *	WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ *	DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER BE LIABLE FOR ANY
+ *	DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ *	(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ *	LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ *	ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *	(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ *	SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ ***********************************************************************************************//**
+ *
+ *	@file					stats_decode.c
+ *
+ *	@brief					host side decoder for binary round records
+ *
+ *	@version				$Id$
+ *	@date					Added for binary statistics export
+ *
+ *	@author					Modified for auto assignment
+ *
+ ***************************************************************************************************
+
+ 	@details
+
+	Reads the UART log of a node built with STATS_BINARY_EXPORT=1 from stdin and writes it to
+	stdout, with every binary round record (see stats_record.h) replaced by the text report
+	that print_results() in main.c would have printed (Mixer statistics counters followed by
+	the round results). All other bytes are passed through.
+
+	Build and use (e.g.):
+		cc -O2 -o stats_decode tools/stats_decode.c
+		./stats_decode < node.log
+
+ **************************************************************************************************/
+//***** Includes ***********************************************************************************
+
+#include "../stats_record.h"
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+//**************************************************************************************************
+//***** Local Defines and Consts *******************************************************************
+
+#define HEADER_END		(2 + sizeof(stats_record_header_t))
+#define COUNTERS_END	(HEADER_END + sizeof(stats_record_counters_t))
+#define RECORD_SIZE(n)	(COUNTERS_END + 2 * (size_t)(n) + 2)
+
+#define COUNTER(n)		{#n, offsetof(stats_record_counters_t, n), sizeof(((stats_record_counters_t*)0)->n)}
+
+// counters in the order mixer_print_statistics() prints them (32 bit entries are times in us)
+static const struct {
+	const char	*name;
+	size_t		offset;
+	size_t		size;
+} counters[] = {
+	COUNTER(num_sent),
+	COUNTER(num_received),
+	COUNTER(num_resync),
+	COUNTER(num_grid_drift_overflow),
+	COUNTER(num_rx_window_overflow),
+	COUNTER(num_rx_success),
+	COUNTER(num_rx_broken),
+	COUNTER(num_rx_timeout),
+	COUNTER(num_rx_dma_timeout),
+	COUNTER(num_rx_dma_late),
+	COUNTER(num_rx_late),
+	COUNTER(num_tx_late),
+	COUNTER(num_tx_zero_packet),
+	COUNTER(num_tx_fifo_late),
+	COUNTER(num_grid_late),
+	COUNTER(num_rx_slot_mismatch),
+	COUNTER(num_rx_queue_overflow),
+	COUNTER(num_rx_queue_overflow_full_rank),
+	COUNTER(num_rx_queue_processed),
+	COUNTER(slot_full_rank),
+	COUNTER(slot_decoded),
+	COUNTER(slot_off),
+	COUNTER(discovery_exit_slot),
+	COUNTER(discovery_density),
+	COUNTER(wake_up_slot),
+	COUNTER(radio_on_time),
+	COUNTER(low_power_time),
+};
+
+//**************************************************************************************************
+//***** Local (Static) Variables *******************************************************************
+
+static uint8_t	*raw;			// received bytes of a (potential) record (escaped)
+static size_t	raw_size;
+static size_t	raw_length;
+static uint8_t	*buffer;		// unescaped bytes of a (potential) record
+static size_t	buffer_size;
+static size_t	length;
+static int		escape;			// last received byte was STATS_RECORD_ESC
+
+//**************************************************************************************************
+//***** Local Functions ****************************************************************************
+
+static void append(uint8_t **buf, size_t *size, size_t *len, uint8_t c)
+{
+	if (*len == *size)
+	{
+		*size = *size ? 2 * *size : 256;
+		*buf = realloc(*buf, *size);
+		if (NULL == *buf)
+			exit(EXIT_FAILURE);
+	}
+
+	(*buf)[(*len)++] = c;
+}
+
+//**************************************************************************************************
+
+// read little endian value, independent of the host byte order
+static uint32_t read_le(const uint8_t *p, size_t size)
+{
+	uint32_t	v = 0;
+
+	while (size--)
+		v = (v << 8) | p[size];
+
+	return v;
+}
+
+//**************************************************************************************************
+
+// parse the record header field by field (the packed struct only defines the wire layout)
+static void parse_header(const uint8_t *record, stats_record_header_t *h)
+{
+	#define FIELD(n)	h->n = read_le(&record[2 + offsetof(stats_record_header_t, n)], sizeof(h->n))
+	FIELD(version);
+	FIELD(node_id);
+	FIELD(flags);
+	FIELD(round);
+	FIELD(generation_size);
+	FIELD(rank);
+	FIELD(msgs_decoded);
+	FIELD(msgs_not_decoded);
+	FIELD(msgs_weak);
+	FIELD(msgs_wrong);
+	#undef FIELD
+}
+
+//**************************************************************************************************
+
+static int16_t rank_up_slot(const uint8_t *record, unsigned int i)
+{
+	return (int16_t)read_le(&record[COUNTERS_END + 2 * i], 2);
+}
+
+//**************************************************************************************************
+
+// print rows or slots of all filled rows in rank-up order (ties in row order)
+static int compare_rank_up(const void *a, const void *b)
+{
+	const uint32_t	*ka = (const uint32_t*)a;
+	const uint32_t	*kb = (const uint32_t*)b;
+
+	return (*ka > *kb) - (*ka < *kb);
+}
+
+static void print_rank_up(const uint8_t *record, unsigned int generation_size, int print_row)
+{
+	static uint32_t	keys[UINT16_MAX + 1];
+	unsigned int	i, n = 0;
+
+	// key = slot << 16 | row, sorting keys gives slot order with ties in row order
+	for (i = 0; i < generation_size; i++)
+	{
+		int16_t	slot = rank_up_slot(record, i);
+
+		if (slot >= 0)
+			keys[n++] = ((uint32_t)slot << 16) | i;
+	}
+
+	qsort(keys, n, sizeof(keys[0]), compare_rank_up);
+
+	for (i = 0; i < n; i++)
+		printf("%u;", (unsigned int)(print_row ? (keys[i] & 0xFFFF) : (keys[i] >> 16)));
+}
+
+//**************************************************************************************************
+
+static void print_record(const uint8_t *record)
+{
+	stats_record_header_t	h;
+	unsigned int			i;
+
+	parse_header(record, &h);
+
+	// mixer_print_statistics() prints nothing if the node was built without statistics
+	if (h.flags & STATS_RECORD_FLAG_STATISTICS)
+	{
+		printf("statistics:\n");
+
+		for (i = 0; i < sizeof(counters) / sizeof(counters[0]); i++)
+		{
+			uint32_t	v = read_le(&record[HEADER_END + counters[i].offset], counters[i].size);
+
+			if (2 == counters[i].size)
+				printf("%s: %" PRIu32 "\n", counters[i].name, v);
+			else printf("%s: %" PRIu32 "us\n", counters[i].name, v);
+		}
+	}
+
+	printf("# ID:%u round=%" PRIu32 " rank=%u dec=%u !dec=%u weak=%u wrong=%u\n",
+		h.node_id, h.round, h.rank, h.msgs_decoded, h.msgs_not_decoded, h.msgs_weak, h.msgs_wrong);
+
+	printf("# ID:%u rank_up_slot=[", h.node_id);
+	print_rank_up(record, h.generation_size, 0);
+	printf("]\n");
+
+	printf("# ID:%u rank_up_row=[", h.node_id);
+	print_rank_up(record, h.generation_size, 1);
+	printf("]\n");
+}
+
+//**************************************************************************************************
+
+static void feed(uint8_t c);
+
+// buffer does not contain a valid record: pass first byte through, rescan the rest
+static void reject(void)
+{
+	size_t	n = raw_length;
+	uint8_t	*rest = malloc(n);
+
+	if (NULL == rest)
+		exit(EXIT_FAILURE);
+
+	memcpy(rest, raw, n);
+	raw_length = 0;
+	length = 0;
+	escape = 0;
+
+	putchar(rest[0]);
+	for (size_t i = 1; i < n; i++)
+		feed(rest[i]);
+
+	free(rest);
+}
+
+//**************************************************************************************************
+
+static void feed(uint8_t c)
+{
+	static const uint8_t	sync[2] = {STATS_RECORD_SYNC_0, STATS_RECORD_SYNC_1};
+	stats_record_header_t	h;
+
+	if ((raw_length < 2) && (c != sync[raw_length]))
+	{
+		if (raw_length)
+		{
+			reject();
+			feed(c);
+		}
+		else putchar(c);
+		return;
+	}
+
+	append(&raw, &raw_size, &raw_length, c);
+
+	// unescape everything behind the sync bytes, a plain '\n' cannot be part of a record
+	if (raw_length > 2)
+	{
+		if (escape)
+		{
+			escape = 0;
+			if (STATS_RECORD_ESC_LF == c)
+				c = '\n';
+			else if (STATS_RECORD_ESC_ESC == c)
+				c = STATS_RECORD_ESC;
+			else
+			{
+				reject();
+				return;
+			}
+		}
+		else if (STATS_RECORD_ESC == c)
+		{
+			escape = 1;
+			return;
+		}
+		else if ('\n' == c)
+		{
+			reject();
+			return;
+		}
+	}
+
+	append(&buffer, &buffer_size, &length, c);
+
+	if (length < HEADER_END)
+		return;
+
+	parse_header(buffer, &h);
+
+	if (STATS_RECORD_VERSION != h.version)
+	{
+		reject();
+		return;
+	}
+
+	if (length == RECORD_SIZE(h.generation_size))
+	{
+		uint16_t	sum = 0;
+
+		stats_record_checksum(&sum, &buffer[2], length - 4);
+
+		if (((sum & 0xFF) != buffer[length - 2]) || ((sum >> 8) != buffer[length - 1]))
+		{
+			reject();
+			return;
+		}
+
+		print_record(buffer);
+		raw_length = 0;
+		length = 0;
+	}
+}
+
+//**************************************************************************************************
+//***** Global Functions ***************************************************************************
+
+int main(void)
+{
+	int	c;
+
+	while (EOF != (c = getchar()))
+		feed(c);
+
+	// flush incomplete record at end of input
+	while (raw_length)
+		reject();
+
+	return 0;
+}
+
+//**************************************************************************************************
+//**************************************************************************************************